@@ -167,6 +167,63 @@ def index(ctx, clear_existing, dry_run, debug, commits):
     )
 
 
+# How many indexed features per dataset index-stats decodes in full to estimate envelope inflation and selectivity.
+DEFAULT_INDEX_STATS_SAMPLE_SIZE = 1000
+
+# Side lengths, in degrees, of the square spatial filters index-stats uses to estimate selectivity.
+DEFAULT_INDEX_STATS_FILTER_SIZES = (0.01, 0.1, 1.0, 10.0)
+
+
+@spatial_filter.command("index-stats")
+@click.option(
+    "--sample-size",
+    type=click.IntRange(min=1),
+    default=DEFAULT_INDEX_STATS_SAMPLE_SIZE,
+    show_default=True,
+    help="How many indexed features per dataset to examine in full when estimating envelope inflation and selectivity.",
+)
+@click.option(
+    "--filter-size",
+    "filter_sizes",
+    type=float,
+    multiple=True,
+    default=DEFAULT_INDEX_STATS_FILTER_SIZES,
+    show_default=True,
+    help="Side length in degrees of a square spatial filter to estimate selectivity for. Can be given more than once.",
+)
+@click.option(
+    "--output-format",
+    "-o",
+    type=click.Choice(["text", "json"]),
+    default="text",
+)
+@click.pass_context
+def index_stats(ctx, sample_size, filter_sizes, output_format):
+    """
+    Reports on the health of the spatial filter index, for capacity planning. For each dataset, outputs the index
+    size per feature, how many features are unindexed and why, how much envelopes are inflated by the curvature
+    buffer and by quantization, a histogram of envelope areas, and the estimated fraction of features that a
+    spatially-filtered clone would fetch for filters of various sizes. Also reports how many index rows refer to
+    features that are no longer reachable from any ref.
+    """
+    from .index_stats import echo_index_stats, get_index_stats
+
+    if any(size <= 0 for size in filter_sizes):
+        raise click.BadParameter("must be positive", param_hint="--filter-size")
+
+    repo = ctx.obj.get_repo(allowed_states=KartRepoState.ALL_STATES)
+
+    stats = get_index_stats(
+        repo,
+        sample_size=sample_size,
+        filter_sizes=filter_sizes,
+    )
+    if output_format == "json":
+        dump_json_output(stats, sys.stdout)
+    else:
+        echo_index_stats(stats)
+
+
 class SpatialFilterString(StringFromFile):
     """Click option to specify a SpatialFilter."""
 
@@ -465,6 +465,9 @@ def get_geometry(repo, feature_oid):
     col_id = get_geometry.legend_to_col_id.get(legend)
     if col_id is None:
         col_id = _find_geometry_column(fields)
+        if col_id is None:
+            # The geometry is NULL, so we can't yet tell which column it is - try again with the next feature.
+            return None
         get_geometry.legend_to_col_id[legend] = col_id
     return fields[col_id] if col_id is not NO_GEOMETRY_COLUMN else None
 
@@ -548,7 +551,9 @@ class EnvelopeEncoder:
         return normalised * (max_value - min_value) + min_value
 
 
-def get_envelope_for_indexing(geom, transforms, feature_oid):
+def get_envelope_for_indexing(
+    geom, transforms, feature_oid, buffer_for_curvature=True
+):
     """
     Returns an envelope in EPSG:4326 that contains the entire geometry. Tries all of the given transforms to convert
     to EPSG:4326 and returns an envelope containing all of the possibilities. This is so we can find all features that
@@ -557,6 +562,8 @@ def get_envelope_for_indexing(geom, transforms, feature_oid):
     It is always true that s <= n. Normally w <= e unless it crosses the anti-meridian, in which case e < w.
     If the envelope cannot be calculated efficiently or at all, None is returned - a None result can be treated as
     equivalent to [-180, -90, 90, 180].
+    Setting buffer_for_curvature to False gives the envelope without the curvature buffer (see transform_minmax_envelope)
+    - this is only useful for measuring how much the buffer inflates the envelope, not for indexing.
     """
 
     result = None
@@ -567,7 +574,9 @@ def get_envelope_for_indexing(geom, transforms, feature_oid):
         )
 
         for transform in transforms:
-            envelope = transform_minmax_envelope(minmax_envelope, transform)
+            envelope = transform_minmax_envelope(
+                minmax_envelope, transform, buffer_for_curvature=buffer_for_curvature
+            )
             if envelope is None:
                 L.info("Skipped indexing feature %s", feature_oid)
                 return None
@@ -0,0 +1,441 @@
+import logging
+import math
+import random
+from collections import Counter
+
+import click
+from pysqlite3 import dbapi2 as sqlite
+
+from kart.exceptions import NotFound, NO_SPATIAL_FILTER
+from kart.promisor_utils import object_is_promised
+from kart.repo import KartRepoFiles
+from kart.spatial_filter import (
+    DEFAULT_INDEX_STATS_FILTER_SIZES,
+    DEFAULT_INDEX_STATS_SAMPLE_SIZE,
+)
+from kart.spatial_filter.index import (
+    CrsHelper,
+    EnvelopeEncoder,
+    get_envelope_for_indexing,
+    get_geometry,
+    iter_feature_oids,
+    resolve_all_commit_refs,
+)
+
+
+L = logging.getLogger("kart.spatial_filter.index_stats")
+
+# How many of the sampled features are used as the centre of a hypothetical spatial filter.
+NUM_FILTER_CENTRES = 50
+
+# Envelope areas (in square degrees) are bucketed by power of ten, clamped to this range.
+MIN_AREA_EXPONENT = -10
+MAX_AREA_EXPONENT = 4
+
+# Reasons why a feature blob reachable from the repo might have no row in the index:
+# - the dataset has no CRS that can be transformed to EPSG:4326.
+NO_CRS = "no-crs"
+# - the feature has no geometry, or the geometry is NULL.
+NO_GEOMETRY = "no-geometry"
+# - the feature's geometry is empty.
+EMPTY_GEOMETRY = "empty-geometry"
+# - the envelope couldn't be calculated - get_envelope_for_indexing returned None.
+ENVELOPE_NONE = "envelope-none"
+# - the feature blob is not present locally - this is a partial clone.
+PROMISED = "promised"
+# - the feature could be indexed but isn't - the index is out of date.
+NOT_YET_INDEXED = "not-yet-indexed"
+# - the feature has a row in the index, but its envelope can't be decoded - the index is corrupt.
+CORRUPT_ENVELOPE = "corrupt-envelope"
+
+
+def _envelope_area(envelope):
+    """Returns the area in square degrees of a wrapped (w, s, e, n) envelope, which may cross the antimeridian."""
+    w, s, e, n = envelope
+    width = e - w if w <= e else e + 360 - w
+    return width * (n - s)
+
+
+def _area_bucket(area):
+    if area <= 0:
+        return "0"
+    exponent = math.floor(math.log10(area))
+    if exponent < MIN_AREA_EXPONENT:
+        return f"<1e{MIN_AREA_EXPONENT}"
+    if exponent >= MAX_AREA_EXPONENT:
+        return f">=1e{MAX_AREA_EXPONENT}"
+    return f"1e{exponent}"
+
+
+def _area_bucket_order():
+    yield "0"
+    yield f"<1e{MIN_AREA_EXPONENT}"
+    for exponent in range(MIN_AREA_EXPONENT, MAX_AREA_EXPONENT):
+        yield f"1e{exponent}"
+    yield f">=1e{MAX_AREA_EXPONENT}"
+
+
+def _range_overlaps(a1, a2, b1, b2):
+    # Keep in sync with range_overlaps in vendor/spatial-filter/spatial_filter.cpp
+    if b1 < a1:
+        return b2 > a1
+    if a1 < b1:
+        return a2 > b1
+    return b2 != b1 and a2 != a1
+
+
+def _cyclic_range_overlaps(a1, a2, b1, b2):
+    # Keep in sync with cyclic_range_overlaps in vendor/spatial-filter/spatial_filter.cpp
+    if a1 > a2:
+        a2 += 360
+    if b1 > b2:
+        b2 += 360
+    if _range_overlaps(a1, a2, b1, b2):
+        return True
+    if a1 < b1:
+        a1 += 360
+        a2 += 360
+    else:
+        b1 += 360
+        b2 += 360
+    return _range_overlaps(a1, a2, b1, b2)
+
+
+def _envelopes_overlap(env1, env2):
+    """Same test that the spatial-filter extension uses to decide whether a feature matches the filter envelope."""
+    return _cyclic_range_overlaps(
+        env1[0], env1[2], env2[0], env2[2]
+    ) and _range_overlaps(env1[1], env1[3], env2[1], env2[3])
+
+
+def _filter_envelope_around(envelope, size):
+    """Returns a square (w, s, e, n) filter envelope with sides of the given size, centred on the given envelope."""
+    w, s, e, n = envelope
+    if e < w:
+        e += 360
+    cx, cy = (w + e) / 2, (s + n) / 2
+    half = size / 2
+    if size >= 360:
+        fw, fe = -180, 180
+    else:
+        fw, fe = (cx - half + 180) % 360 - 180, (cx + half + 180) % 360 - 180
+    return (fw, max(cy - half, -90), fe, min(cy + half, 90))
+
+
+class DatasetIndexStats:
+    """Statistics about how the features of a single dataset are represented in the spatial filter index."""
+
+    def __init__(self, ds_path, sample_size, rng):
+        self.ds_path = ds_path
+        self.sample_size = sample_size
+        self.rng = rng
+
+        self.features = 0
+        self.indexed = 0
+        self.unindexed_reasons = Counter()
+        self.area_histogram = Counter()
+        # Reservoir sample of (feature_oid, decoded_envelope) for indexed features.
+        self.sample = []
+
+    def add_indexed(self, feature_oid, envelope):
+        self.features += 1
+        self.indexed += 1
+        self.area_histogram[_area_bucket(_envelope_area(envelope))] += 1
+
+        if len(self.sample) < self.sample_size:
+            self.sample.append((feature_oid, envelope))
+        else:
+            i = self.rng.randrange(self.indexed)
+            if i < self.sample_size:
+                self.sample[i] = (feature_oid, envelope)
+
+    def add_unindexed(self, reason):
+        self.features += 1
+        self.unindexed_reasons[reason] += 1
+
+    @property
+    def unindexed(self):
+        return self.features - self.indexed
+
+    def inflation(self, repo, crs_helper):
+        """
+        Recalculates the envelopes of the sampled features with and without the curvature buffer, and compares them
+        to the quantized envelopes stored in the index. Returns a dict of area ratios (>= 1.0), which are None
+        if no sampled features had a non-zero area.
+        """
+        transforms = crs_helper.transforms_for_dataset(self.ds_path)
+        raw_area = buffered_area = 0.0
+        buffered_nonzero_area = quantized_area = 0.0
+        for feature_oid, quantized in self.sample:
+            try:
+                geom = get_geometry(repo, feature_oid)
+            except KeyError:
+                continue
+            if geom is None or geom.is_empty() or not transforms:
+                continue
+            raw = get_envelope_for_indexing(
+                geom, transforms, feature_oid, buffer_for_curvature=False
+            )
+            buffered = get_envelope_for_indexing(geom, transforms, feature_oid)
+            if raw is None or buffered is None:
+                continue
+            if _envelope_area(raw) > 0:
+                raw_area += _envelope_area(raw)
+                buffered_area += _envelope_area(buffered)
+            if _envelope_area(buffered) > 0:
+                buffered_nonzero_area += _envelope_area(buffered)
+                quantized_area += _envelope_area(quantized)
+
+        return {
+            "curvatureBuffer": buffered_area / raw_area if raw_area else None,
+            "quantization": (
+                quantized_area / buffered_nonzero_area
+                if buffered_nonzero_area
+                else None
+            ),
+        }
+
+    def selectivity(self, filter_sizes):
+        """
+        Estimates the fraction of this dataset's features that a spatially-filtered clone would fetch, for a square
+        filter of each of the given sizes (in degrees). Filters are centred on randomly sampled features, since that
+        is where users are likely to be interested in. Unindexed features are always fetched.
+        """
+        if not self.features:
+            return {}
+        centres = self.rng.sample(
+            self.sample, min(NUM_FILTER_CENTRES, len(self.sample))
+        )
+        result = {}
+        for size in filter_sizes:
+            if centres:
+                matched = 0
+                for _, centre in centres:
+                    filter_envelope = _filter_envelope_around(centre, size)
+                    matched += sum(
+                        1
+                        for _, envelope in self.sample
+                        if _envelopes_overlap(filter_envelope, envelope)
+                    )
+                indexed_fraction = matched / (len(centres) * len(self.sample))
+            else:
+                indexed_fraction = 0.0
+            result[size] = (
+                self.unindexed + self.indexed * indexed_fraction
+            ) / self.features
+        return result
+
+
+def _classify_unindexed(repo, crs_helper, ds_path, feature_oid):
+    if not crs_helper.transforms_for_dataset(ds_path):
+        return NO_CRS
+    try:
+        geom = get_geometry(repo, feature_oid)
+    except KeyError as e:
+        if object_is_promised(e):
+            return PROMISED
+        raise
+    if geom is None:
+        return NO_GEOMETRY
+    if geom.is_empty():
+        return EMPTY_GEOMETRY
+    transforms = crs_helper.transforms_for_dataset(ds_path)
+    if get_envelope_for_indexing(geom, transforms, feature_oid) is None:
+        return ENVELOPE_NONE
+    return NOT_YET_INDEXED
+
+
+def _decode_or_none(encoder, encoded):
+    """
+    Decodes the given envelope, or returns None if it is corrupt - the wrong length, or south of its north edge.
+    Keep in sync with the checks in sf_filter_blob in vendor/spatial-filter/spatial_filter.cpp
+    """
+    if encoder is None or len(encoded) != encoder.BYTES_PER_ENVELOPE:
+        return None
+    envelope = encoder.decode(encoded)
+    if envelope[1] > envelope[3]:
+        return None
+    return envelope
+
+
+def get_index_stats(
+    repo,
+    sample_size=DEFAULT_INDEX_STATS_SAMPLE_SIZE,
+    filter_sizes=DEFAULT_INDEX_STATS_FILTER_SIZES,
+    seed=0,
+):
+    """
+    Analyses the feature_envelopes.db index against every feature reachable from any ref in the repo, and returns
+    a dict of statistics about the index as a whole and about each dataset - useful for capacity planning.
+    """
+    db_path = repo.gitdir_file(KartRepoFiles.FEATURE_ENVELOPES)
+    if not db_path.is_file():
+        raise NotFound(
+            "No spatial filter index found - run kart spatial-filter index",
+            exit_code=NO_SPATIAL_FILTER,
+        )
+
+    crs_helper = CrsHelper(repo)
+    rng = random.Random(seed)
+    ds_stats = {}
+    reachable_rows = 0
+    corrupt_rows = 0
+
+    # The index is looked up one feature at a time rather than loaded into memory, since the indexes
+    # we most want to analyse are also the largest.
+    db = sqlite.connect(f"file:{db_path}?mode=ro", uri=True)
+    try:
+        dbcur = db.cursor()
+        tables = {
+            row[0]
+            for row in dbcur.execute(
+                "SELECT name FROM sqlite_master WHERE type='table';"
+            )
+        }
+        for table in ("feature_envelopes", "commits"):
+            if table not in tables:
+                raise NotFound(
+                    f"Spatial filter index {db_path} has no {table} table - run kart spatial-filter index --clear-existing",
+                    exit_code=NO_SPATIAL_FILTER,
+                )
+
+        page_count = dbcur.execute("PRAGMA page_count;").fetchone()[0]
+        page_size = dbcur.execute("PRAGMA page_size;").fetchone()[0]
+        rows = dbcur.execute("SELECT count(*) FROM feature_envelopes;").fetchone()[0]
+        # Use the most common envelope length, so that a single corrupt row can't spoil every other row.
+        envelope_length = dbcur.execute(
+            "SELECT length(envelope) FROM feature_envelopes "
+            "GROUP BY length(envelope) ORDER BY count(*) DESC LIMIT 1;"
+        ).fetchone()
+        indexed_commits = dbcur.execute("SELECT count(*) FROM commits;").fetchone()[0]
+
+        encoder = None
+        if envelope_length is not None and envelope_length[0]:
+            encoder = EnvelopeEncoder(envelope_length[0] * 8 // 4)
+
+        commits = resolve_all_commit_refs(repo)
+        feature_oid_iter = iter_feature_oids(repo, commits, [])
+        for i, (ds_path, feature_oid) in enumerate(feature_oid_iter):
+            if i and i % 100_000 == 0:
+                L.info("Analysed %d features...", i)
+
+            stats = ds_stats.get(ds_path)
+            if stats is None:
+                stats = ds_stats[ds_path] = DatasetIndexStats(ds_path, sample_size, rng)
+
+            row = dbcur.execute(
+                "SELECT envelope FROM feature_envelopes WHERE blob_id=?;",
+                (bytes.fromhex(feature_oid),),
+            ).fetchone()
+            if row is not None:
+                reachable_rows += 1
+                envelope = _decode_or_none(encoder, row[0])
+                if envelope is not None:
+                    stats.add_indexed(feature_oid, envelope)
+                else:
+                    corrupt_rows += 1
+                    stats.add_unindexed(CORRUPT_ENVELOPE)
+            else:
+                stats.add_unindexed(
+                    _classify_unindexed(repo, crs_helper, ds_path, feature_oid)
+                )
+    finally:
+        db.close()
+
+    # rev-list outputs each blob only once, so any other rows refer to blobs that aren't reachable from any ref.
+    unreachable_rows = rows - reachable_rows
+
+    # The file also contains the commits table, unreachable rows and free pages - these are spread evenly
+    # over all rows, so per-dataset sizes are only estimates.
+    file_bytes = page_count * page_size
+    bytes_per_row = file_bytes / rows if rows else None
+
+    datasets = {}
+    for ds_path, stats in sorted(ds_stats.items()):
+        index_bytes = stats.indexed * bytes_per_row if bytes_per_row else 0
+        datasets[ds_path] = {
+            "featureBlobs": stats.features,
+            "indexed": stats.indexed,
+            "unindexed": stats.unindexed,
+            "unindexedReasons": dict(stats.unindexed_reasons.most_common()),
+            "estimatedIndexBytes": round(index_bytes),
+            "estimatedBytesPerFeatureBlob": (
+                index_bytes / stats.features if stats.features else None
+            ),
+            "envelopeAreaHistogram": {
+                bucket: stats.area_histogram[bucket]
+                for bucket in _area_bucket_order()
+                if stats.area_histogram[bucket]
+            },
+            "envelopeInflation": stats.inflation(repo, crs_helper),
+            "selectivity": {
+                str(size): fraction
+                for size, fraction in stats.selectivity(filter_sizes).items()
+            },
+        }
+
+    return {
+        "index": {
+            "path": str(db_path),
+            "fileBytes": file_bytes,
+            "rows": rows,
+            "bytesPerRow": bytes_per_row,
+            "bitsPerValue": encoder.BITS_PER_VALUE if encoder else None,
+            "indexedCommits": indexed_commits,
+            "unreachableRows": unreachable_rows,
+            "corruptRows": corrupt_rows,
+        },
+        "datasets": datasets,
+    }
+
+
+def _format_optional(value, fmt):
+    return "-" if value is None else format(value, fmt)
+
+
+def echo_index_stats(stats):
+    """Outputs the result of get_index_stats as human-readable text."""
+    index = stats["index"]
+    click.echo(f"Index: {index['path']}")
+    click.echo(f"  Size: {index['fileBytes']:,d} bytes")
+    click.echo(
+        f"  Rows: {index['rows']:,d} ({_format_optional(index['bytesPerRow'], '.1f')} bytes per row)"
+    )
+    click.echo(f"  Unreachable rows: {index['unreachableRows']:,d}")
+    click.echo(f"  Corrupt rows: {index['corruptRows']:,d}")
+    click.echo(f"  Bits per value: {_format_optional(index['bitsPerValue'], 'd')}")
+
+    for ds_path, ds in stats["datasets"].items():
+        click.echo()
+        click.echo(f"{ds_path}:")
+        features = ds["featureBlobs"]
+        click.echo(f"  Feature blobs (all versions): {features:,d}")
+        click.echo(f"  Indexed: {ds['indexed']:,d}")
+        click.echo(
+            f"  Unindexed: {ds['unindexed']:,d} ({ds['unindexed'] / features:.1%})"
+        )
+        for reason, count in ds["unindexedReasons"].items():
+            click.echo(f"    {reason}: {count:,d} ({count / features:.1%})")
+        click.echo(
+            f"  Estimated index size: {ds['estimatedIndexBytes']:,d} bytes "
+            f"({_format_optional(ds['estimatedBytesPerFeatureBlob'], '.1f')} bytes per feature blob)"
+        )
+
+        inflation = ds["envelopeInflation"]
+        click.echo("  Envelope inflation (area ratio):")
+        click.echo(
+            f"    Curvature buffer: {_format_optional(inflation['curvatureBuffer'], '.3f')}"
+        )
+        click.echo(
+            f"    Quantization: {_format_optional(inflation['quantization'], '.3f')}"
+        )
+
+        if ds["envelopeAreaHistogram"]:
+            click.echo("  Envelope area histogram (square degrees):")
+            for bucket, count in ds["envelopeAreaHistogram"].items():
+                click.echo(f"    {bucket:>8}: {count:,d}")
+
+        if ds["selectivity"]:
+            click.echo("  Estimated selectivity (filter side in degrees):")
+            for size, fraction in ds["selectivity"].items():
+                click.echo(f"    {size:>8}: {fraction:.2%}")
@@ -14,6 +14,9 @@ from kart.exceptions import (
 )
 from kart.promisor_utils import FetchPromisedBlobsProcess, LibgitSubcode
 from kart.repo import KartRepo
+from kart.spatial_filter.index import EnvelopeEncoder
+from kart.sqlalchemy.sqlite import sqlite_engine
+from sqlalchemy.orm import sessionmaker
 
 H = pytest.helpers.helpers()
 
@@ -356,6 +359,114 @@ def test_clone_with_spatial_filter(
         # test spatially filtered cloning separately from spatially filtered clone behaviour.
 
 
+def _drop_index_table(sess):
+    sess.execute("DROP TABLE feature_envelopes;")
+
+
+def _corrupt_envelopes(envelope):
+    # Every row is corrupted, so that the very first lookup fails, whichever feature that happens to be for.
+    def _corrupt(sess):
+        sess.execute(
+            "UPDATE feature_envelopes SET envelope = :envelope;",
+            {"envelope": envelope},
+        )
+
+    return _corrupt
+
+
+def _slow_index_lookups(sess):
+    # Replace the index table with a view that does a lot of pointless work every time it is queried.
+    sess.execute("ALTER TABLE feature_envelopes RENAME TO feature_envelopes_slow;")
+    sess.execute(
+        "CREATE VIEW feature_envelopes AS SELECT blob_id, envelope FROM feature_envelopes_slow "
+        "WHERE (WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c WHERE x < 200000) "
+        "SELECT count(*) FROM c) > 0;"
+    )
+
+
+LOOKUP_FAILED = "index lookup failed"
+BUDGET_EXCEEDED = "latency budget exceeded"
+
+
+@pytest.mark.parametrize(
+    "break_index,budget_ms,fallback_reason",
+    [
+        # With no table, the index is treated as unavailable - there is no fallback since nothing is filtered at all.
+        pytest.param(_drop_index_table, None, None, id="no-table"),
+        # Longer than any envelope the filter can decode.
+        pytest.param(
+            _corrupt_envelopes(b"\x00" * 16), None, LOOKUP_FAILED, id="bad-length"
+        ),
+        pytest.param(_corrupt_envelopes(b""), None, LOOKUP_FAILED, id="empty-envelope"),
+        pytest.param(
+            # South edge above north edge.
+            _corrupt_envelopes(EnvelopeEncoder().encode((174, -37, 175, -38))),
+            None,
+            LOOKUP_FAILED,
+            id="south-above-north",
+        ),
+        pytest.param(_slow_index_lookups, "1", BUDGET_EXCEEDED, id="budget-exceeded"),
+    ],
+)
+def test_clone_with_spatial_filter_falls_back_to_match_all(
+    git_with_spatial_filter_support,
+    data_archive,
+    cli_runner,
+    tmp_path,
+    break_index,
+    budget_ms,
+    fallback_reason,
+):
+    # If the index can't be used, or is too slow, the spatial filter matches everything rather than failing the clone.
+    geom = SPATIAL_FILTER_GEOMETRY["polygons"]
+    crs = SPATIAL_FILTER_CRS["polygons"]
+
+    file_path = (tmp_path / "spatialfilter.txt").resolve()
+    file_path.write_text(f"{crs}\n\n{geom}\n", encoding="utf-8")
+
+    with data_archive("polygons-with-feature-envelopes") as repo1_path:
+        repo1_url = f"file://{repo1_path.resolve()}"
+
+        engine = sqlite_engine(repo1_path / ".kart" / "feature_envelopes.db")
+        with sessionmaker(bind=engine)() as sess:
+            break_index(sess)
+
+        trace_path = (tmp_path / "trace.txt").resolve()
+        os.environ["X_KART_SPATIAL_FILTERED_CLONE"] = "1"
+        os.environ["GIT_TRACE_FILTER"] = str(trace_path)
+        if budget_ms is not None:
+            os.environ["KART_SPATIAL_FILTER_BUDGET_MS"] = budget_ms
+        try:
+            repo2_path = tmp_path / "repo2"
+            r = cli_runner.invoke(
+                ["clone", repo1_url, repo2_path, f"--spatial-filter=@{file_path}"]
+            )
+            assert r.exit_code == 0, r.stderr
+
+            repo2 = KartRepo(repo2_path)
+            ds = repo2.datasets()[H.POLYGONS.LAYER]
+            if fallback_reason == BUDGET_EXCEEDED:
+                # The first lookup can still complete (and omit its feature) if the budget isn't yet spent.
+                # But since every lookup is slower than the budget, everything after that is sent.
+                assert local_features(ds) >= H.POLYGONS.ROWCOUNT - 1
+            else:
+                assert local_features(ds) == H.POLYGONS.ROWCOUNT
+
+            with repo2.working_copy.session() as sess:
+                assert H.row_count(sess, H.POLYGONS.LAYER) == 44
+
+            trace = trace_path.read_text() if trace_path.exists() else ""
+            if fallback_reason is None:
+                assert "fallback=match-all" not in trace
+            else:
+                assert f'fallback=match-all reason="{fallback_reason}"' in trace
+
+        finally:
+            del os.environ["X_KART_SPATIAL_FILTERED_CLONE"]
+            del os.environ["GIT_TRACE_FILTER"]
+            os.environ.pop("KART_SPATIAL_FILTER_BUDGET_MS", None)
+
+
 def test_spatially_filtered_partial_clone(data_archive, cli_runner):
     crs = SPATIAL_FILTER_CRS["polygons"]
 
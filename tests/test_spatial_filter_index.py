@@ -1,10 +1,12 @@
 import binascii
 from dataclasses import dataclass
+import json
 import pytest
 
 from osgeo import osr
 
 from kart.crs_util import make_crs
+from kart.exceptions import NO_SPATIAL_FILTER
 from kart.sqlalchemy.sqlite import sqlite_engine
 from kart.spatial_filter.index import (
     EnvelopeEncoder,
@@ -329,6 +331,167 @@ def test_index_antimeridian_3882(data_archive, cli_runner):
         _check_index(s, EXPECTED_ANTIMERIDIAN_3832_INDEX, 0.2)
 
 
+def test_index_stats_points(data_archive, cli_runner):
+    with data_archive("points.tgz") as repo_path:
+        r = cli_runner.invoke(["spatial-filter", "index-stats"])
+        assert r.exit_code == NO_SPATIAL_FILTER, r.stderr
+
+        r = cli_runner.invoke(["spatial-filter", "index"])
+        assert r.exit_code == 0, r.stderr
+
+        # Add a row for a blob that isn't in the repo.
+        db_path = repo_path / ".kart" / "feature_envelopes.db"
+        engine = sqlite_engine(db_path)
+        with sessionmaker(bind=engine)() as sess:
+            sess.execute(
+                "INSERT INTO feature_envelopes (blob_id, envelope) VALUES (:b, :e);",
+                {"b": b"\x00" * 20, "e": EnvelopeEncoder().encode((0, 0, 0, 0))},
+            )
+
+        r = cli_runner.invoke(["spatial-filter", "index-stats", "-o", "json"])
+        assert r.exit_code == 0, r.stderr
+        stats = json.loads(r.stdout)
+
+        assert stats["index"]["rows"] == 2149
+        assert stats["index"]["unreachableRows"] == 1
+        assert stats["index"]["bitsPerValue"] == 20
+
+        assert list(stats["datasets"].keys()) == [H.POINTS.LAYER]
+        ds = stats["datasets"][H.POINTS.LAYER]
+        assert ds["indexed"] == 2148
+        assert sum(ds["envelopeAreaHistogram"].values()) == 2148
+        # Points have no area, so the curvature buffer doesn't inflate them.
+        assert ds["envelopeInflation"]["curvatureBuffer"] is None
+
+        selectivity = list(ds["selectivity"].values())
+        assert len(selectivity) == 4
+        assert all(0 < s <= 1 for s in selectivity)
+        assert selectivity == sorted(selectivity)
+
+
+def test_index_stats_polygons(data_archive, cli_runner):
+    with data_archive("polygons.tgz") as repo_path:
+        r = cli_runner.invoke(["spatial-filter", "index"])
+        assert r.exit_code == 0, r.stderr
+
+        r = cli_runner.invoke(
+            ["spatial-filter", "index-stats", "--filter-size=0.5", "-o", "json"]
+        )
+        assert r.exit_code == 0, r.stderr
+        stats = json.loads(r.stdout)
+
+        assert stats["index"]["unreachableRows"] == 0
+        ds = stats["datasets"][H.POLYGONS.LAYER]
+        assert ds["indexed"] == 228
+        assert ds["estimatedBytesPerFeatureBlob"] > 0
+        assert ds["envelopeInflation"]["curvatureBuffer"] > 1
+        assert ds["envelopeInflation"]["quantization"] >= 1
+        assert list(ds["selectivity"].keys()) == ["0.5"]
+
+        r = cli_runner.invoke(["spatial-filter", "index-stats"])
+        assert r.exit_code == 0, r.stderr
+        assert "Envelope area histogram" in r.stdout
+
+
+def test_index_stats_table(data_archive, cli_runner):
+    with data_archive("table.tgz") as repo_path:
+        r = cli_runner.invoke(["spatial-filter", "index"])
+        assert r.exit_code == 0, r.stderr
+
+        r = cli_runner.invoke(["spatial-filter", "index-stats", "-o", "json"])
+        assert r.exit_code == 0, r.stderr
+        stats = json.loads(r.stdout)
+
+        assert stats["index"]["rows"] == 0
+        (ds,) = stats["datasets"].values()
+        assert ds["featureBlobs"] > 0
+        assert ds["indexed"] == 0
+        assert ds["unindexedReasons"] == {"no-crs": ds["featureBlobs"]}
+        assert ds["selectivity"] == {str(size): 1.0 for size in (0.01, 0.1, 1.0, 10.0)}
+
+
+def test_index_stats_broken_index(data_archive, cli_runner):
+    with data_archive("points.tgz") as repo_path:
+        r = cli_runner.invoke(["spatial-filter", "index"])
+        assert r.exit_code == 0, r.stderr
+
+        db_path = repo_path / ".kart" / "feature_envelopes.db"
+        engine = sqlite_engine(db_path)
+        with sessionmaker(bind=engine)() as sess:
+            # One envelope that is too short, and one whose south edge is above its north edge.
+            sess.execute(
+                "UPDATE feature_envelopes SET envelope = :e WHERE blob_id = :b;",
+                {
+                    "b": bytes.fromhex(EXPECTED_POINTS_INDEX.first_blob_id.blob_id),
+                    "e": b"\x00\x00\x00",
+                },
+            )
+            sess.execute(
+                "UPDATE feature_envelopes SET envelope = :e WHERE blob_id = :b;",
+                {
+                    "b": bytes.fromhex(EXPECTED_POINTS_INDEX.last_blob_id.blob_id),
+                    "e": EnvelopeEncoder().encode((174, -37, 175, -38)),
+                },
+            )
+
+        r = cli_runner.invoke(["spatial-filter", "index-stats", "-o", "json"])
+        assert r.exit_code == 0, r.stderr
+        stats = json.loads(r.stdout)
+
+        assert stats["index"]["rows"] == 2148
+        assert stats["index"]["corruptRows"] == 2
+        assert stats["index"]["unreachableRows"] == 0
+        ds = stats["datasets"][H.POINTS.LAYER]
+        assert ds["indexed"] == 2146
+        assert ds["unindexedReasons"] == {"corrupt-envelope": 2}
+
+        with sessionmaker(bind=engine)() as sess:
+            sess.execute("DROP TABLE feature_envelopes;")
+
+        r = cli_runner.invoke(["spatial-filter", "index-stats"])
+        assert r.exit_code == NO_SPATIAL_FILTER
+        assert "has no feature_envelopes table" in r.stderr
+
+
+def test_index_stats_not_yet_indexed(data_archive, cli_runner):
+    with data_archive("points.tgz"):
+        # Only index up to HEAD^ - the features added at HEAD are not yet indexed.
+        r = cli_runner.invoke(["spatial-filter", "index", H.POINTS.HEAD1_SHA])
+        assert r.exit_code == 0, r.stderr
+
+        r = cli_runner.invoke(["spatial-filter", "index-stats", "-o", "json"])
+        assert r.exit_code == 0, r.stderr
+        stats = json.loads(r.stdout)
+
+        assert stats["index"]["rows"] == 2143
+        assert stats["index"]["unreachableRows"] == 0
+        ds = stats["datasets"][H.POINTS.LAYER]
+        assert ds["indexed"] == 2143
+        assert ds["unindexedReasons"] == {"not-yet-indexed": 5}
+
+
+def test_index_stats_empty_geometry(data_archive, cli_runner):
+    with data_archive("empty-geometry.tgz"):
+        r = cli_runner.invoke(["spatial-filter", "index"])
+        assert r.exit_code == 0, r.stderr
+
+        r = cli_runner.invoke(["spatial-filter", "index-stats", "-o", "json"])
+        assert r.exit_code == 0, r.stderr
+        stats = json.loads(r.stdout)
+
+        assert stats["index"]["rows"] == 0
+        assert list(stats["datasets"].keys()) == ["point_test", "polygon_test"]
+        for ds in stats["datasets"].values():
+            assert ds["featureBlobs"] == 2
+            assert ds["indexed"] == 0
+            # Each dataset has one feature with a NULL geometry and one with an empty geometry.
+            assert ds["unindexedReasons"] == {"no-geometry": 1, "empty-geometry": 1}
+            assert ds["envelopeInflation"] == {
+                "curvatureBuffer": None,
+                "quantization": None,
+            }
+
+
 def _get_index_summary(repo_path, unwrap_lon=-180):
     db_path = repo_path / ".kart" / "feature_envelopes.db"
     engine = sqlite_engine(db_path)